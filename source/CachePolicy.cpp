@@ -0,0 +1,267 @@
+﻿#include "CachePolicy.h"
+
+#include <cstdint>
+
+CachePolicy::CachePolicy(const std::vector<ModuleConfig::CacheRuleConfig>& rules) {
+	for (auto& rule : rules) {
+		/** Check Match */
+		if (rule.match.empty()) {
+			this->errorList.push_back("Cache rule #" + std::to_string(&rule - rules.data())
+				+ " ignored: missing \"match\"");
+			continue;
+		}
+		if (!CachePolicy::checkMatch(rule.match)) {
+			this->errorList.push_back("Cache rule \"" + rule.match
+				+ "\" ignored: only \"/path\", \"/path/**\" and \"*.ext\" are supported");
+			continue;
+		}
+
+		/** Preformat Header */
+		std::string error;
+		auto header = CachePolicy::formatHeader(rule, error);
+		if (header.empty()) {
+			this->errorList.push_back("Cache rule \"" + rule.match + "\" ignored: " + error);
+			continue;
+		}
+
+		/** Add Rule */
+		if (!this->addRule(rule.match, header, error)) {
+			this->errorList.push_back("Cache rule \"" + rule.match + "\" ignored: " + error);
+		}
+	}
+}
+
+const std::string* CachePolicy::find(std::string_view path) const {
+	/** Earliest Matching Rule In Config Order Wins */
+	const Rule* result = nullptr;
+	auto pick = [&result](const Rule* rule) {
+		if (rule && (!result || std::get<0>(*rule) < std::get<0>(*result))) {
+			result = rule;
+		}
+	};
+
+	/** Match Path Trie */
+	const Node* node = &(this->root);
+	pick(node->prefix);
+	std::string_view lastSegment;
+
+	size_t start = 0;
+	while (start < path.size()) {
+		/** Get Segment */
+		size_t end = path.find('/', start);
+		if (end == std::string_view::npos) {
+			end = path.size();
+		}
+		std::string_view segment = path.substr(start, end - start);
+		start = end + 1;
+		if (segment.empty()) {
+			continue;
+		}
+		lastSegment = segment;
+
+		/** Walk */
+		if (node) {
+			auto it = node->children.find(segment);
+			node = (it != node->children.end()) ? it->second.get() : nullptr;
+			if (node) {
+				pick(node->prefix);
+			}
+		}
+	}
+
+	/** Exact Path */
+	if (node) {
+		pick(node->exact);
+	}
+
+	/** Match Extension */
+	size_t idx = lastSegment.rfind('.');
+	if (idx != std::string_view::npos) {
+		auto it = this->extensionList.find(lastSegment.substr(idx));
+		if (it != this->extensionList.end()) {
+			pick(it->second);
+		}
+	}
+
+	return result ? &std::get<2>(*result) : nullptr;
+}
+
+const std::vector<std::string>& CachePolicy::getErrors() const {
+	return this->errorList;
+}
+
+bool CachePolicy::addRule(const std::string& match, const std::string& header, std::string& error) {
+	/** Earlier Rule Covering Every Path This One Matches */
+	auto shadowed = [&error](const Rule* rule) {
+		if (rule) {
+			error = "shadowed by earlier rule \"" + std::get<1>(*rule) + "\"";
+			return true;
+		}
+		return false;
+	};
+
+	/** Root Prefix Matches Everything */
+	if (shadowed(this->root.prefix)) {
+		return false;
+	}
+
+	/** Extension Rule: "*.ext" */
+	if (match.starts_with("*.")) {
+		std::string ext = match.substr(1);
+		auto it = this->extensionList.find(ext);
+		if (shadowed((it != this->extensionList.end()) ? it->second : nullptr)) {
+			return false;
+		}
+
+		this->ruleList.push_back({ this->ruleList.size(), match, header });
+		this->extensionList[ext] = &(this->ruleList.back());
+		return true;
+	}
+
+	/** Prefix Rule Ends With Double Star, Otherwise Exact Path */
+	bool isPrefix = match.ends_with("/**");
+	std::string_view path = match;
+	if (isPrefix) {
+		path.remove_suffix(2);
+	}
+
+	/** Walk Trie, Creating Nodes */
+	Node* node = &(this->root);
+	std::string_view lastSegment;
+	size_t start = 0;
+	while (start < path.size()) {
+		size_t end = path.find('/', start);
+		if (end == std::string_view::npos) {
+			end = path.size();
+		}
+		std::string_view segment = path.substr(start, end - start);
+		start = end + 1;
+		if (segment.empty()) {
+			continue;
+		}
+		lastSegment = segment;
+
+		auto& child = node->children[std::string{ segment }];
+		if (!child) {
+			child = std::make_unique<Node>();
+		}
+		node = child.get();
+
+		/** Earlier Prefix Above Or At This Path */
+		if (shadowed(node->prefix)) {
+			return false;
+		}
+	}
+
+	/** Exact Path Also Shadowed By Same Path Or Its Extension */
+	if (!isPrefix) {
+		if (shadowed(node->exact)) {
+			return false;
+		}
+		size_t idx = lastSegment.rfind('.');
+		if (idx != std::string_view::npos) {
+			auto it = this->extensionList.find(lastSegment.substr(idx));
+			if (shadowed((it != this->extensionList.end()) ? it->second : nullptr)) {
+				return false;
+			}
+		}
+	}
+
+	/** Add Rule */
+	this->ruleList.push_back({ this->ruleList.size(), match, header });
+	(isPrefix ? node->prefix : node->exact) = &(this->ruleList.back());
+	return true;
+}
+
+bool CachePolicy::checkMatch(const std::string& match) {
+	/** Extension */
+	if (match.starts_with("*.")) {
+		return match.size() > 2 && match.find_first_of("*/", 1) == std::string::npos;
+	}
+
+	/** Path Or Prefix, No Other Wildcards */
+	if (!match.starts_with("/")) {
+		return false;
+	}
+	std::string_view path = match;
+	if (path.ends_with("/**")) {
+		path.remove_suffix(2);
+	}
+	return path.find('*') == std::string_view::npos;
+}
+
+const std::string CachePolicy::formatHeader(const ModuleConfig::CacheRuleConfig& rule, std::string& error) {
+	/** Raw Header */
+	if (!rule.cacheControl.empty()) {
+		return rule.cacheControl;
+	}
+
+	/** Build Header */
+	if (rule.noStore) {
+		return "no-store";
+	}
+	if (rule.noCache) {
+		return "no-cache";
+	}
+	if (rule.maxAge.empty()) {
+		error = rule.immutable ? "immutable requires maxAge" : "no cache directive set";
+		return {};
+	}
+
+	int64_t maxAge = 0;
+	if (!CachePolicy::parseDuration(rule.maxAge, maxAge, error)) {
+		return {};
+	}
+
+	std::string result = "public, max-age=" + std::to_string(maxAge);
+	if (rule.immutable) {
+		result += ", immutable";
+	}
+	return result;
+}
+
+bool CachePolicy::parseDuration(const std::string& str, int64_t& result, std::string& error) {
+	static std::map<char, int64_t> units = {
+		{'s', 1},
+		{'m', 60},
+		{'h', 60 * 60},
+		{'d', 24 * 60 * 60},
+		{'w', 7 * 24 * 60 * 60},
+		{'y', 365 * 24 * 60 * 60}
+	};
+
+	/** Digits Only, Then Optional Unit */
+	size_t idx = 0;
+	int64_t value = 0;
+	for (; idx < str.size() && str[idx] >= '0' && str[idx] <= '9'; idx++) {
+		int64_t digit = str[idx] - '0';
+		if (value > (INT64_MAX - digit) / 10) {
+			error = "maxAge \"" + str + "\" out of range";
+			return false;
+		}
+		value = value * 10 + digit;
+	}
+	if (idx == 0 || idx + 1 < str.size()) {
+		error = "invalid maxAge \"" + str + "\", expected digits with optional s/m/h/d/w/y unit";
+		return false;
+	}
+
+	/** Get Unit */
+	int64_t unit = 1;
+	if (idx < str.size()) {
+		auto it = units.find(str[idx]);
+		if (it == units.end()) {
+			error = "invalid maxAge unit in \"" + str + "\", expected s/m/h/d/w/y";
+			return false;
+		}
+		unit = it->second;
+	}
+
+	/** Check Overflow */
+	if (value > INT64_MAX / unit) {
+		error = "maxAge \"" + str + "\" out of range";
+		return false;
+	}
+	result = value * unit;
+	return true;
+}
@@ -0,0 +1,36 @@
+﻿#pragma once
+
+#include "ModuleConfig.h"
+
+#include <string>
+#include <string_view>
+#include <map>
+#include <memory>
+#include <vector>
+#include <list>
+#include <tuple>
+
+class CachePolicy final {
+public:
+	CachePolicy(const std::vector<ModuleConfig::CacheRuleConfig>& rules = {});
+
+	const std::string* find(std::string_view path) const;
+	const std::vector<std::string>& getErrors() const;
+
+private:
+	using Rule = std::tuple<size_t, std::string, std::string>;
+	struct Node final {
+		std::map<std::string, std::unique_ptr<Node>, std::less<>> children;
+		const Rule* exact = nullptr;
+		const Rule* prefix = nullptr;
+	};
+	Node root;
+	std::map<std::string, const Rule*, std::less<>> extensionList;
+	std::list<Rule> ruleList;
+	std::vector<std::string> errorList;
+
+	bool addRule(const std::string& match, const std::string& header, std::string& error);
+	static bool checkMatch(const std::string& match);
+	static const std::string formatHeader(const ModuleConfig::CacheRuleConfig& rule, std::string& error);
+	static bool parseDuration(const std::string& str, int64_t& result, std::string& error);
+};
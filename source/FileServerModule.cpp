@@ -3,16 +3,34 @@
 #include <regex>
 #include <filesystem>
 #include <cstring>
+#include <cstdlib>
+#include <ctime>
+#include <chrono>
+#include <algorithm>
 
 FileServerModule::FileServerModule() {
 	/** Load Config */
 	this->config = std::make_unique<ModuleConfig>("LiteHttpd.FileServer.json");
 
 	/** Init Temp */
-	this->temp = std::make_unique<FileTemp>(this->config->getSurvival());
+	this->temp = std::make_unique<FileTemp>(
+		this->config->getSurvival(), this->config->getTempConf());
+
+	/** Init Cache Policy */
+	this->policy = std::make_unique<CachePolicy>(this->config->getCacheRules());
 }
 
 void FileServerModule::processRequest(const RequestParams& rp) {
+	/** Log Config Errors And Ignored Cache Rules Once */
+	std::call_once(this->policyLogFlag, [this, &rp] {
+		for (auto& error : this->config->getErrors()) {
+			rp.log(RequestParams::LogLevel::WARNING, error);
+		}
+		for (auto& error : this->policy->getErrors()) {
+			rp.log(RequestParams::LogLevel::WARNING, error);
+		}
+	});
+
 	/** Get Path */
 	std::string root = this->config->getRoot();
 	root = FileServerModule::replaceString(root, "\\$hostname\\$", rp.addr);
@@ -23,7 +41,9 @@ void FileServerModule::processRequest(const RequestParams& rp) {
 	if (path.empty()) {
 		path += "/";
 	}
+	std::string dirPath;
 	if (path.ends_with('/')) {
+		dirPath = path;
 		path += this->config->getDefaultPage();
 	}
 
@@ -47,7 +67,7 @@ void FileServerModule::processRequest(const RequestParams& rp) {
 		rp.log(RequestParams::LogLevel::INFO, "403 page path: " + errPath);
 
 		/** Get 403 Page */
-		auto [errPtr, errSize] = this->temp->get(errPath);
+		auto [errPtr, errSize] = this->temp->get(root, errPath);
 		if (!errPtr) {
 			rp.log(RequestParams::LogLevel::ERROR_, "Can't load 403 page, send 500!");
 			rp.reply(500, std::vector<char>{});
@@ -63,7 +83,58 @@ void FileServerModule::processRequest(const RequestParams& rp) {
 	}
 
 	/** Get Data */
-	auto [ptr, size] = this->temp->get(path);
+	auto [ptr, size] = this->temp->get(root, path);
+
+	/** Log Temp Partitions */
+	this->logTempStats(rp);
+
+	/** Auto Index */
+	if (!ptr && !dirPath.empty() && this->config->getAutoIndexOn()) {
+		std::error_code ec;
+		auto dirTime = std::filesystem::last_write_time(dirPath, ec);
+		if (!ec && std::filesystem::is_directory(dirPath, ec)) {
+			/** Get Page */
+			auto& autoIndexConf = this->config->getAutoIndexConf();
+			size_t page = std::strtoull(
+				FileServerModule::getQueryParam(rp.query, "page").c_str(), nullptr, 10);
+
+			/** Get Sorted Scan, Once Per Directory Version */
+			std::string version = std::to_string(dirTime.time_since_epoch().count());
+			auto scan = this->temp->get(root, dirPath + "\nautoindex-scan:" + version,
+				[&dirPath, &autoIndexConf] {
+					return FileServerModule::scanDirectory(dirPath, autoIndexConf.showHidden); }, false);
+
+			/** Get Page, Keyed By Directory Version And Scan Time */
+			FileTemp::MemoryBlock listing;
+			if (std::get<0>(scan)) {
+				std::string key = dirPath + "\nautoindex:" + autoIndexConf.format
+					+ ":" + std::to_string(page) + ":" + version
+					+ ":" + std::to_string(FileServerModule::getScanTime(scan));
+				listing = this->temp->get(root, key,
+					[&scan, &rp, &autoIndexConf, page] {
+						return FileServerModule::createAutoIndex(scan, rp.path, autoIndexConf, page);
+					}, false);
+			}
+			auto& [listPtr, listSize] = listing;
+
+			if (listPtr) {
+				/** Set MIME Type */
+				rp.addHeader("Content-Type",
+					(autoIndexConf.format == "json") ? "application/json" : "text/html");
+
+				/** Listings Change With The Directory, Always Revalidate */
+				rp.addHeader("Cache-Control", "no-cache");
+
+				/** Reply 200 */
+				std::vector<char> data;
+				data.resize(listSize);
+				std::memcpy(data.data(), listPtr.get(), listSize);
+				rp.reply(200, data);
+				rp.log(RequestParams::LogLevel::INFO, "Send auto index with data size: " + std::to_string(listSize));
+				return;
+			}
+		}
+	}
 
 	/** 404 */
 	if (!ptr) {
@@ -77,7 +148,7 @@ void FileServerModule::processRequest(const RequestParams& rp) {
 		rp.log(RequestParams::LogLevel::INFO, "404 page path: " + errPath);
 
 		/** Get 404 Page */
-		auto [errPtr, errSize] = this->temp->get(errPath);
+		auto [errPtr, errSize] = this->temp->get(root, errPath);
 		if (!errPtr) {
 			rp.log(RequestParams::LogLevel::ERROR_, "Can't load 404 page, send 500!");
 			rp.reply(500, std::vector<char>{});
@@ -139,6 +210,20 @@ void FileServerModule::processRequest(const RequestParams& rp) {
 		rp.log(RequestParams::LogLevel::INFO, "Set MIME type: " + mimeType);
 	}
 
+	/** Set Cache Control */
+	{
+		/** Match On Normalized Path Relative To Root */
+		std::string servedPath = rp.path;
+		if (!dirPath.empty()) {
+			servedPath += this->config->getDefaultPage();
+		}
+		servedPath = std::filesystem::path(servedPath).lexically_normal().generic_string();
+
+		if (auto cacheControl = this->policy->find(servedPath)) {
+			rp.addHeader("Cache-Control", *cacheControl);
+		}
+	}
+
 	/** Reply 200 */
 	std::vector<char> data;
 	data.resize(size);
@@ -147,6 +232,28 @@ void FileServerModule::processRequest(const RequestParams& rp) {
 	rp.log(RequestParams::LogLevel::INFO, "Send 200 with data size: " + std::to_string(size));
 }
 
+void FileServerModule::logTempStats(const RequestParams& rp) {
+	/** Check Interval */
+	time_t interval = this->config->getTempConf().statsInterval;
+	if (interval <= 0) {
+		return;
+	}
+	time_t currentTime = std::time(nullptr);
+	time_t lastTime = this->lastStatsTime;
+	if (currentTime - lastTime < interval ||
+		!this->lastStatsTime.compare_exchange_strong(lastTime, currentTime)) {
+		return;
+	}
+
+	/** Log Each Partition */
+	for (auto& [name, stats] : this->temp->getAllStats()) {
+		rp.log(RequestParams::LogLevel::INFO, "Temp partition " + name + ": "
+			+ std::to_string(stats.usage) + " bytes in " + std::to_string(stats.entries) + " files"
+			+ ", quota: " + std::to_string(stats.quota) + ", reserved: " + std::to_string(stats.reserved)
+			+ ", hits: " + std::to_string(stats.hits) + ", misses: " + std::to_string(stats.misses));
+	}
+}
+
 const std::string FileServerModule::replaceString(const std::string& input,
 	const std::string& what, const std::string& replaceTo) {
 	return std::regex_replace(input, std::regex(what), replaceTo);
@@ -433,4 +540,295 @@ const std::string FileServerModule::trim(const std::string& str) {
 	return (front < back) ? std::string{ front, back } : std::string{};
 }
 
+const std::string FileServerModule::getQueryParam(const std::string& query, const std::string& name) {
+	size_t start = 0;
+	while (start <= query.size()) {
+		size_t end = query.find('&', start);
+		if (end == std::string::npos) {
+			end = query.size();
+		}
+
+		std::string item = query.substr(start, end - start);
+		if (item.starts_with(name + "=")) {
+			return item.substr(name.size() + 1);
+		}
+
+		start = end + 1;
+	}
+	return {};
+}
+
+const FileTemp::MemoryBlock FileServerModule::scanDirectory(const std::string& dirPath, bool showHidden) {
+	/** Entry */
+	using Entry = AutoIndexEntry;
+	std::vector<Entry> entries;
+
+	/** Scan Directory */
+	std::error_code ec;
+	for (auto it = std::filesystem::directory_iterator(dirPath, ec);
+		!ec && it != std::filesystem::directory_iterator(); it.increment(ec)) {
+		/** Skip Hidden */
+		std::string name = it->path().filename().string();
+		if (!showHidden && name.starts_with(".")) {
+			continue;
+		}
+
+		/** Don't Follow Symlinks Out Of Root */
+		auto status = it->symlink_status(ec);
+		if (ec) {
+			ec.clear();
+			continue;
+		}
+		if (std::filesystem::is_symlink(status)) {
+			entries.push_back({ name, AutoIndexType::Symlink, 0, 0 });
+			continue;
+		}
+
+		auto type = std::filesystem::is_directory(status) ? AutoIndexType::Directory : AutoIndexType::File;
+		uint64_t size = (type == AutoIndexType::File) ? std::filesystem::file_size(it->path(), ec) : 0;
+		if (ec) { size = 0; ec.clear(); }
+
+		time_t mtime = 0;
+		auto fileTime = std::filesystem::last_write_time(it->path(), ec);
+		if (!ec) {
+			mtime = std::chrono::system_clock::to_time_t(
+				std::chrono::file_clock::to_sys(fileTime));
+		}
+		ec.clear();
+
+		entries.push_back({ name, type, size, mtime });
+	}
+	if (ec) {
+		return { nullptr, 0 };
+	}
+
+	/** Directories First, Then By Name */
+	std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) {
+		bool aDir = (std::get<1>(a) == AutoIndexType::Directory);
+		bool bDir = (std::get<1>(b) == AutoIndexType::Directory);
+		if (aDir != bDir) {
+			return aDir;
+		}
+		return std::get<0>(a) < std::get<0>(b);
+	});
+
+	/** Block: int64 scanTime, uint64 count, uint64 offset[count], entries */
+	/** Entry: uint8 type, uint64 size, int64 mtime, uint32 nameSize, name */
+	constexpr size_t entryHeadSize = sizeof(uint8_t) + sizeof(uint64_t) + sizeof(int64_t) + sizeof(uint32_t);
+	size_t blockSize = sizeof(int64_t) + sizeof(uint64_t) + entries.size() * sizeof(uint64_t);
+	for (auto& entry : entries) {
+		blockSize += entryHeadSize + std::get<0>(entry).size();
+	}
+
+	/** Write Block */
+	auto buffer = std::shared_ptr<char>(new char[blockSize], [](char* p) { delete[] p; });
+	char* head = buffer.get();
+	auto write = [&head](const void* src, size_t size) {
+		std::memcpy(head, src, size);
+		head += size;
+	};
+
+	int64_t scanTime = std::time(nullptr);
+	uint64_t count = entries.size();
+	write(&scanTime, sizeof(scanTime));
+	write(&count, sizeof(count));
+
+	uint64_t offset = sizeof(int64_t) + sizeof(uint64_t) + entries.size() * sizeof(uint64_t);
+	for (auto& entry : entries) {
+		write(&offset, sizeof(offset));
+		offset += entryHeadSize + std::get<0>(entry).size();
+	}
+
+	for (auto& [name, type, size, mtime] : entries) {
+		uint8_t typeFlag = static_cast<uint8_t>(type);
+		int64_t time = mtime;
+		uint32_t nameSize = static_cast<uint32_t>(name.size());
+		write(&typeFlag, sizeof(typeFlag));
+		write(&size, sizeof(size));
+		write(&time, sizeof(time));
+		write(&nameSize, sizeof(nameSize));
+		write(name.data(), name.size());
+	}
+
+	return { buffer, blockSize };
+}
+
+time_t FileServerModule::getScanTime(const FileTemp::MemoryBlock& scan) {
+	int64_t scanTime = 0;
+	std::memcpy(&scanTime, std::get<0>(scan).get(), sizeof(scanTime));
+	return static_cast<time_t>(scanTime);
+}
+
+size_t FileServerModule::getScanSize(const FileTemp::MemoryBlock& scan) {
+	uint64_t count = 0;
+	std::memcpy(&count, std::get<0>(scan).get() + sizeof(int64_t), sizeof(count));
+	return static_cast<size_t>(count);
+}
+
+const FileServerModule::AutoIndexEntry FileServerModule::getScanEntry(
+	const FileTemp::MemoryBlock& scan, size_t index) {
+	const char* data = std::get<0>(scan).get();
+
+	/** Get Offset */
+	uint64_t offset = 0;
+	std::memcpy(&offset, data + sizeof(int64_t) + sizeof(uint64_t) + index * sizeof(uint64_t), sizeof(offset));
+	const char* head = data + offset;
+	auto read = [&head](void* dst, size_t size) {
+		std::memcpy(dst, head, size);
+		head += size;
+	};
+
+	/** Read Entry */
+	uint8_t typeFlag = 0;
+	uint64_t size = 0;
+	int64_t mtime = 0;
+	uint32_t nameSize = 0;
+	read(&typeFlag, sizeof(typeFlag));
+	read(&size, sizeof(size));
+	read(&mtime, sizeof(mtime));
+	read(&nameSize, sizeof(nameSize));
+
+	return { std::string{ head, nameSize }, static_cast<AutoIndexType>(typeFlag), size, static_cast<time_t>(mtime) };
+}
+
+const FileTemp::MemoryBlock FileServerModule::createAutoIndex(const FileTemp::MemoryBlock& scan,
+	const std::string& urlPath, const ModuleConfig::AutoIndexConfig& autoIndexConf, size_t page) {
+	size_t total = FileServerModule::getScanSize(scan);
+
+	/** Page Range */
+	size_t pageSize = (autoIndexConf.pageSize > 0) ? autoIndexConf.pageSize : total;
+	size_t pageCount = (pageSize > 0) ? (total + pageSize - 1) / pageSize : 0;
+	if (page > 0 && page >= pageCount) {
+		return { nullptr, 0 };
+	}
+	size_t begin = std::min(page * pageSize, total);
+	size_t end = std::min(begin + pageSize, total);
+
+	/** Render */
+	std::string result;
+	if (autoIndexConf.format == "json") {
+		result += "{\"path\":\"" + FileServerModule::escapeJSON(urlPath) + "\"";
+		result += ",\"page\":" + std::to_string(page);
+		result += ",\"pageCount\":" + std::to_string(pageCount);
+		result += ",\"total\":" + std::to_string(total);
+		result += ",\"entries\":[";
+		for (size_t i = begin; i < end; i++) {
+			auto [name, type, size, mtime] = FileServerModule::getScanEntry(scan, i);
+			if (i > begin) {
+				result += ",";
+			}
+			result += "{\"name\":\"" + FileServerModule::escapeJSON(name) + "\"";
+			result += ",\"type\":\"" + std::string{ (type == AutoIndexType::Directory) ? "directory"
+				: (type == AutoIndexType::Symlink) ? "symlink" : "file" } + "\"";
+			result += ",\"size\":" + std::to_string(size);
+			result += ",\"mtime\":" + std::to_string(mtime) + "}";
+		}
+		result += "]}";
+	}
+	else {
+		std::string title = "Index of " + FileServerModule::escapeHTML(urlPath);
+		result += "<!DOCTYPE html>\n<html>\n<head><meta charset=\"utf-8\"><title>" + title + "</title></head>\n";
+		result += "<body>\n<h1>" + title + "</h1>\n<table>\n";
+		result += "<tr><th>Name</th><th>Size</th><th>Last Modified</th></tr>\n";
+		if (urlPath != "/") {
+			result += "<tr><td><a href=\"../\">../</a></td><td></td><td></td></tr>\n";
+		}
+		for (size_t i = begin; i < end; i++) {
+			auto [name, type, size, mtime] = FileServerModule::getScanEntry(scan, i);
+			bool isDir = (type == AutoIndexType::Directory);
+			std::string displayName = FileServerModule::escapeHTML(name) + (isDir ? "/" : "");
+			std::string href = FileServerModule::encodeURL(name) + (isDir ? "/" : "");
+
+			std::tm timeInfo = {};
+#if WIN32
+			gmtime_s(&timeInfo, &mtime);
+#else
+			gmtime_r(&mtime, &timeInfo);
+#endif
+			char timeStr[32] = "-";
+			if (type != AutoIndexType::Symlink) {
+				std::strftime(timeStr, sizeof(timeStr), "%Y-%m-%d %H:%M:%S", &timeInfo);
+			}
+
+			result += "<tr><td><a href=\"" + href + "\">" + displayName + "</a></td>";
+			result += "<td>" + ((type != AutoIndexType::File) ? std::string{ "-" } : std::to_string(size)) + "</td>";
+			result += "<td>" + std::string{ timeStr } + "</td></tr>\n";
+		}
+		result += "</table>\n";
+		if (pageCount > 1) {
+			result += "<p>";
+			if (page > 0) {
+				result += "<a href=\"?page=" + std::to_string(page - 1) + "\">Previous</a> ";
+			}
+			result += "Page " + std::to_string(page + 1) + " of " + std::to_string(pageCount);
+			if (page + 1 < pageCount) {
+				result += " <a href=\"?page=" + std::to_string(page + 1) + "\">Next</a>";
+			}
+			result += "</p>\n";
+		}
+		result += "</body>\n</html>\n";
+	}
+
+	/** Copy To Block */
+	auto buffer = std::shared_ptr<char>(new char[result.size()], [](char* p) { delete[] p; });
+	std::memcpy(buffer.get(), result.data(), result.size());
+	return { buffer, result.size() };
+}
+
+const std::string FileServerModule::escapeHTML(const std::string& str) {
+	std::string result;
+	for (auto c : str) {
+		switch (c) {
+		case '&': result += "&amp;"; break;
+		case '<': result += "&lt;"; break;
+		case '>': result += "&gt;"; break;
+		case '"': result += "&quot;"; break;
+		case '\'': result += "&#39;"; break;
+		default: result += c; break;
+		}
+	}
+	return result;
+}
+
+const std::string FileServerModule::escapeJSON(const std::string& str) {
+	std::string result;
+	for (auto c : str) {
+		switch (c) {
+		case '"': result += "\\\""; break;
+		case '\\': result += "\\\\"; break;
+		case '\n': result += "\\n"; break;
+		case '\r': result += "\\r"; break;
+		case '\t': result += "\\t"; break;
+		default:
+			if (static_cast<unsigned char>(c) < 0x20) {
+				char buf[8] = {};
+				std::snprintf(buf, sizeof(buf), "\\u%04x", static_cast<unsigned char>(c));
+				result += buf;
+			}
+			else {
+				result += c;
+			}
+			break;
+		}
+	}
+	return result;
+}
+
+const std::string FileServerModule::encodeURL(const std::string& str) {
+	static const char hex[] = "0123456789ABCDEF";
+	std::string result;
+	for (auto c : str) {
+		auto uc = static_cast<unsigned char>(c);
+		if (std::isalnum(uc) || c == '-' || c == '_' || c == '.' || c == '~') {
+			result += c;
+		}
+		else {
+			result += '%';
+			result += hex[uc >> 4];
+			result += hex[uc & 0xF];
+		}
+	}
+	return result;
+}
+
 LITEHTTPD_MODULE(FileServerModule)
@@ -3,10 +3,14 @@
 #include <LiteHttpdDev.h>
 
 #include "FileTemp.h"
+#include "CachePolicy.h"
 #include "ModuleConfig.h"
 
 #include <memory>
 #include <vector>
+#include <atomic>
+#include <ctime>
+#include <mutex>
 
 class FileServerModule final : public ModuleBase {
 public:
@@ -18,6 +22,11 @@ public:
 private:
 	std::unique_ptr<FileTemp> temp = nullptr;
 	std::unique_ptr<ModuleConfig> config = nullptr;
+	std::unique_ptr<CachePolicy> policy = nullptr;
+	std::once_flag policyLogFlag;
+	std::atomic<time_t> lastStatsTime = 0;
+
+	void logTempStats(const RequestParams& rp);
 
 	static const std::string replaceString(const std::string& input,
 		const std::string& what, const std::string& replaceTo);
@@ -31,4 +40,16 @@ private:
 	static const RequestParams::ParamList parseFPMHeader(const std::vector<char>& data);
 	static const std::vector<char> parseFPMContent(const std::vector<char>& data);
 	static const std::string trim(const std::string& str);
+	static const std::string getQueryParam(const std::string& query, const std::string& name);
+	enum class AutoIndexType : uint8_t { File = 0, Directory = 1, Symlink = 2 };
+	using AutoIndexEntry = std::tuple<std::string, AutoIndexType, uint64_t, time_t>;
+	static const FileTemp::MemoryBlock scanDirectory(const std::string& dirPath, bool showHidden);
+	static time_t getScanTime(const FileTemp::MemoryBlock& scan);
+	static size_t getScanSize(const FileTemp::MemoryBlock& scan);
+	static const AutoIndexEntry getScanEntry(const FileTemp::MemoryBlock& scan, size_t index);
+	static const FileTemp::MemoryBlock createAutoIndex(const FileTemp::MemoryBlock& scan,
+		const std::string& urlPath, const ModuleConfig::AutoIndexConfig& autoIndexConf, size_t page);
+	static const std::string escapeHTML(const std::string& str);
+	static const std::string escapeJSON(const std::string& str);
+	static const std::string encodeURL(const std::string& str);
 };
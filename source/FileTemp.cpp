@@ -1,55 +1,383 @@
 ﻿#include "FileTemp.h"
 
 #include <cstdio>
+#include <cstring>
+#include <bit>
+#include <algorithm>
 
-FileTemp::FileTemp(time_t survivalTime)
-	: survivalTime(survivalTime) {}
+FileTemp::FileTemp(time_t survivalTime, const ModuleConfig::TempConfig& tempConf)
+	: survivalTime(survivalTime), tempConf(tempConf) {}
 
-FileTemp::MemoryBlock FileTemp::get(const std::string& path) {
+FileTemp::MemoryBlock FileTemp::get(const std::string& partition, const std::string& path) {
+	return this->get(partition, path, [&path] { return FileTemp::loadFile(path); });
+}
+
+FileTemp::MemoryBlock FileTemp::get(const std::string& partition,
+	const std::string& key, const Loader& loader, bool refresh) {
 	/** Check Temp Time */
 	this->checkTempTime();
 
-	/** Result */
-	MemoryBlock result;
-
-	do {
+	/** Find In Temp */
+	auto found = this->findPartition(partition);
+	if (auto part = found = this->findPartition(partition)) {
 		/** Lock */
-		std::lock_guard locker(this->listLock);
-
-		/** Find In Temp */
-		auto it = this->tempList.find(path);
-		if (it != this->tempList.end()) {
-			/** Get Result */
-			result = std::get<1>(it->second);
+		std::lock_guard locker(part->listLock);
 
+		auto it = part->tempList.find(key);
+		if (it != part->tempList.end()) {
 			/** Update Time */
-			std::get<0>(it->second) = std::time(nullptr);
+			if (refresh) {
+				std::get<0>(it->second) = std::time(nullptr);
+			}
 
-			/** Done */
-			break;
+			/** Update LRU */
+			auto& lruIt = std::get<2>(it->second);
+			part->lruList.splice(part->lruList.begin(), part->lruList, lruIt);
+
+			/** Hit */
+			part->counter->hits++;
+			return std::get<1>(it->second);
+		}
+	}
+
+	/** Miss, Counted Even Without Partition */
+	auto counter = found ? found->counter : this->getCounter(partition);
+	counter->misses++;
+
+	/** Load Data */
+	auto data = loader();
+	auto& [ptr, size] = data;
+	if (!ptr) {
+		return data;
+	}
+
+	/** Too Large For Partition */
+	auto& partConf = this->getPartitionConf(partition);
+	if (partConf.quota > 0 && size > partConf.quota) {
+		return data;
+	}
+
+	/** Too Large For Temp */
+	if (this->tempConf.capacity > 0 && size > this->tempConf.capacity) {
+		return data;
+	}
+
+	/** Share Identical Content */
+	uint64_t hash = FileTemp::hashContent(ptr.get(), size);
+	bool created = false;
+	auto block = this->acquireBlock(data, hash, created);
+
+	/** Make Room For New Content */
+	if (created && this->tempConf.capacity > 0) {
+		auto current = this->findPartition(partition);
+		if (!this->reclaim(0, current.get())) {
+			this->releaseBlock(block, hash);
+			return data;
 		}
+	}
+
+	while (true) {
+		/** Partition Only Created When Something Is Cached */
+		auto part = this->getPartition(partition);
 
-		/** Load File */
-		auto data = FileTemp::loadFile(path);
-		if (std::get<0>(data)) {
-			/** Set Result */
-			result = data;
+		/** Lock */
+		std::lock_guard locker(part->listLock);
 
-			/** Add Temp */
-			this->tempList.insert(std::make_pair(
-				path, std::make_tuple( std::time(nullptr), data )));
+		/** Removed By Sweep, Retry */
+		if (part->removed) {
+			continue;
 		}
 
-	} while (false);
+		/** Loaded By Other Thread */
+		auto it = part->tempList.find(key);
+		if (it != part->tempList.end()) {
+			this->releaseBlock(block, hash);
+			return std::get<1>(it->second);
+		}
+
+		/** Add Temp */
+		part->lruList.push_front(key);
+		part->tempList.insert(std::make_pair(
+			key, std::make_tuple(std::time(nullptr), block, part->lruList.begin(), hash)));
+		part->usage += size;
+
+		/** Check Quota */
+		while (part->conf.quota > 0 && part->usage > part->conf.quota) {
+			this->removeTemp(*part, part->tempList.find(part->lruList.back()));
+		}
+		break;
+	}
 
 	/** Return */
-	return result;
+	return block;
 }
 
 void FileTemp::checkTempTime() {
+	/** Check At Most Once Per Second */
+	time_t currentTime = std::time(nullptr);
+	time_t lastTime = this->lastCheckTime;
+	if (lastTime == currentTime ||
+		!this->lastCheckTime.compare_exchange_strong(lastTime, currentTime)) {
+		return;
+	}
+
 	this->checkTempTimeInternal(this->survivalTime);
 }
 
+const std::map<std::string, FileTemp::PartitionStats> FileTemp::getAllStats() {
+	std::map<std::string, PartitionStats> result;
+
+	/** Get Counters, Kept After Partitions Are Dropped */
+	{
+		std::shared_lock locker(this->counterLock);
+		for (auto& [name, counter] : this->counterList) {
+			auto& conf = this->getPartitionConf(name);
+			auto& stats = result[name];
+			stats.quota = conf.quota;
+			stats.reserved = conf.reserved;
+			stats.hits = counter->hits;
+			stats.misses = counter->misses;
+		}
+	}
+
+	/** Get Usage Of Each Partition */
+	{
+		std::shared_lock locker(this->partitionLock);
+		for (auto& [name, ptr] : this->partitionList) {
+			auto& part = *ptr;
+			std::lock_guard partLocker(part.listLock);
+			auto& stats = result[name];
+			stats.usage = part.usage;
+			stats.entries = part.tempList.size();
+			stats.quota = part.conf.quota;
+			stats.reserved = part.conf.reserved;
+		}
+	}
+
+	/** Partitions Over Stats Limit */
+	if (this->otherCounter->hits > 0 || this->otherCounter->misses > 0) {
+		auto& stats = result["*"];
+		stats.hits = this->otherCounter->hits;
+		stats.misses = this->otherCounter->misses;
+	}
+
+	return result;
+}
+
+std::shared_ptr<FileTemp::Counter> FileTemp::getCounter(const std::string& partition) {
+	{
+		/** Find Existing Counter */
+		std::shared_lock locker(this->counterLock);
+		auto it = this->counterList.find(partition);
+		if (it != this->counterList.end()) {
+			return it->second;
+		}
+	}
+
+	/** Lock */
+	std::unique_lock locker(this->counterLock);
+	auto it = this->counterList.find(partition);
+	if (it != this->counterList.end()) {
+		return it->second;
+	}
+
+	/** Unconfigured Partitions Over Limit Share One Counter */
+	if (this->tempConf.statsLimit > 0 && this->counterList.size() >= this->tempConf.statsLimit
+		&& !this->tempConf.partitions.contains(partition)) {
+		return this->otherCounter;
+	}
+
+	/** Create Counter */
+	auto counter = std::make_shared<Counter>();
+	this->counterList.insert(std::make_pair(partition, counter));
+	return counter;
+}
+
+std::shared_ptr<FileTemp::Partition> FileTemp::findPartition(const std::string& partition) {
+	/** Lock */
+	std::shared_lock locker(this->partitionLock);
+
+	/** Find Existing Partition */
+	auto it = this->partitionList.find(partition);
+	if (it != this->partitionList.end()) {
+		return it->second;
+	}
+	return nullptr;
+}
+
+std::shared_ptr<FileTemp::Partition> FileTemp::getPartition(const std::string& partition) {
+	/** Find Existing Partition */
+	if (auto part = this->findPartition(partition)) {
+		return part;
+	}
+
+	/** Create Partition */
+	std::unique_lock locker(this->partitionLock);
+	auto& ptr = this->partitionList[partition];
+	if (!ptr) {
+		ptr = std::make_shared<Partition>();
+		ptr->conf = this->getPartitionConf(partition);
+		ptr->counter = this->getCounter(partition);
+	}
+	return ptr;
+}
+
+const ModuleConfig::PartitionConfig& FileTemp::getPartitionConf(const std::string& partition) const {
+	auto it = this->tempConf.partitions.find(partition);
+	return (it != this->tempConf.partitions.end())
+		? it->second : this->tempConf.defaultPartition;
+}
+
+bool FileTemp::reclaim(size_t size, const Partition* current) {
+	/** Lock */
+	std::shared_lock locker(this->partitionLock);
+
+	/** Evict Entries Above Reserved Size */
+	auto evict = [this, size](Partition& part) {
+		std::lock_guard partLocker(part.listLock);
+		auto lruIt = part.lruList.end();
+		while (lruIt != part.lruList.begin()
+			&& this->totalUsage + size > this->tempConf.capacity
+			&& part.usage > part.conf.reserved) {
+			auto it = part.tempList.find(*(--lruIt));
+
+			/** Shared Block Frees Nothing */
+			if (this->getBlockRefCount(std::get<1>(it->second), std::get<3>(it->second)) > 1) {
+				continue;
+			}
+
+			lruIt++;
+			this->removeTemp(part, it);
+		}
+	};
+
+	/** Requesting Partition First, Then Others */
+	for (auto& [name, ptr] : this->partitionList) {
+		if (ptr.get() == current) {
+			evict(*ptr);
+		}
+	}
+	for (auto& [name, ptr] : this->partitionList) {
+		if (this->totalUsage + size <= this->tempConf.capacity) {
+			break;
+		}
+		if (ptr.get() != current) {
+			evict(*ptr);
+		}
+	}
+
+	return this->totalUsage + size <= this->tempConf.capacity;
+}
+
+void FileTemp::removeTemp(Partition& partition,
+	std::map<std::string, DataHolder>::iterator it) {
+	auto& data = std::get<1>(it->second);
+	partition.usage -= std::get<1>(data);
+	this->releaseBlock(data, std::get<3>(it->second));
+
+	partition.lruList.erase(std::get<2>(it->second));
+	partition.tempList.erase(it);
+}
+
+FileTemp::MemoryBlock FileTemp::acquireBlock(
+	const MemoryBlock& data, uint64_t hash, bool& created) {
+	auto& [ptr, size] = data;
+
+	/** Blocks Already Compared */
+	std::vector<char*> comparedList;
+
+	while (true) {
+		/** Get Candidates */
+		std::vector<std::shared_ptr<char>> candidateList;
+		{
+			std::lock_guard locker(this->blockLock);
+			auto range = this->blockList.equal_range(hash);
+			for (auto it = range.first; it != range.second; it++) {
+				auto& [blockPtr, blockSize] = std::get<0>(it->second);
+				if (blockSize == size && std::find(comparedList.begin(),
+					comparedList.end(), blockPtr.get()) == comparedList.end()) {
+					candidateList.push_back(blockPtr);
+				}
+			}
+		}
+
+		/** Compare Without Lock */
+		char* matched = nullptr;
+		for (auto& candidate : candidateList) {
+			comparedList.push_back(candidate.get());
+			if (std::memcmp(candidate.get(), ptr.get(), size) == 0) {
+				matched = candidate.get();
+				break;
+			}
+		}
+
+		/** Lock */
+		std::lock_guard locker(this->blockLock);
+
+		/** Recheck Blocks */
+		bool hasNew = false;
+		auto range = this->blockList.equal_range(hash);
+		for (auto it = range.first; it != range.second; it++) {
+			auto& [block, refCount] = it->second;
+			auto& [blockPtr, blockSize] = block;
+			if (matched && blockPtr.get() == matched) {
+				refCount++;
+				created = false;
+				return block;
+			}
+			if (blockSize == size && std::find(comparedList.begin(),
+				comparedList.end(), blockPtr.get()) == comparedList.end()) {
+				hasNew = true;
+			}
+		}
+
+		/** Added By Other Thread, Compare Again */
+		if (hasNew) {
+			continue;
+		}
+
+		/** Add Block */
+		this->blockList.insert(std::make_pair(hash, std::make_tuple(data, 1)));
+		this->totalUsage += size;
+		created = true;
+		return data;
+	}
+}
+
+void FileTemp::releaseBlock(const MemoryBlock& data, uint64_t hash) {
+	/** Lock */
+	std::lock_guard locker(this->blockLock);
+
+	/** Find Block */
+	auto range = this->blockList.equal_range(hash);
+	for (auto it = range.first; it != range.second; it++) {
+		auto& [block, refCount] = it->second;
+		if (std::get<0>(block) == std::get<0>(data)) {
+			/** Remove Block When Unused */
+			if (--refCount == 0) {
+				this->totalUsage -= std::get<1>(block);
+				this->blockList.erase(it);
+			}
+			return;
+		}
+	}
+}
+
+size_t FileTemp::getBlockRefCount(const MemoryBlock& data, uint64_t hash) {
+	/** Lock */
+	std::lock_guard locker(this->blockLock);
+
+	/** Find Block */
+	auto range = this->blockList.equal_range(hash);
+	for (auto it = range.first; it != range.second; it++) {
+		auto& [block, refCount] = it->second;
+		if (std::get<0>(block) == std::get<0>(data)) {
+			return refCount;
+		}
+	}
+	return 0;
+}
+
 FileTemp::MemoryBlock FileTemp::loadFile(const std::string& path) {
 	FILE* file = fopen(path.c_str(), "rb");
 	if (file) {
@@ -68,9 +396,6 @@ FileTemp::MemoryBlock FileTemp::loadFile(const std::string& path) {
 }
 
 void FileTemp::checkTempTimeInternal(time_t survivalTime) {
-	/** Lock */
-	std::lock_guard locker(this->listLock);
-
 	/** Get Temp Valid Time */
 	time_t validTime = 0;
 	time_t currentTime = std::time(nullptr);
@@ -78,13 +403,114 @@ void FileTemp::checkTempTimeInternal(time_t survivalTime) {
 		validTime = currentTime - survivalTime;
 	}
 
-	/** Check Each Temp */
-	for (auto it = this->tempList.begin(); it != tempList.end();) {
-		if (std::get<0>(it->second) < validTime) {
-			it = this->tempList.erase(it);
-			continue;
+	/** Empty Partitions Without Config */
+	std::vector<std::string> emptyList;
+
+	{
+		/** Lock */
+		std::shared_lock locker(this->partitionLock);
+
+		/** Check Each Partition */
+		for (auto& [name, ptr] : this->partitionList) {
+			auto& part = *ptr;
+			std::lock_guard partLocker(part.listLock);
+
+			/** Oldest Temp At LRU Back */
+			while (!part.lruList.empty()) {
+				auto it = part.tempList.find(part.lruList.back());
+				if (std::get<0>(it->second) >= validTime) {
+					break;
+				}
+				this->removeTemp(part, it);
+			}
+
+			/** Mark Empty */
+			if (part.tempList.empty() && !this->tempConf.partitions.contains(name)) {
+				emptyList.push_back(name);
+			}
+		}
+	}
+
+	/** Remove Empty Partitions */
+	if (!emptyList.empty()) {
+		/** Lock */
+		std::unique_lock locker(this->partitionLock);
+
+		for (auto& name : emptyList) {
+			auto it = this->partitionList.find(name);
+			if (it == this->partitionList.end()) {
+				continue;
+			}
+
+			/** Still Empty */
+			auto part = it->second;
+			std::lock_guard partLocker(part->listLock);
+			if (part->tempList.empty()) {
+				part->removed = true;
+				this->partitionList.erase(it);
+			}
 		}
+	}
+}
+
+uint64_t FileTemp::hashContent(const char* data, size_t size) {
+	/** xxHash64, Four Independent Lanes Per 32 Bytes Stripe */
+	constexpr uint64_t prime1 = 11400714785074694791ULL;
+	constexpr uint64_t prime2 = 14029467366897019727ULL;
+	constexpr uint64_t prime3 = 1609587929392820161ULL;
+	constexpr uint64_t prime4 = 9650029242287828579ULL;
+	constexpr uint64_t prime5 = 2870177450012600261ULL;
+
+	auto read64 = [](const char* p) { uint64_t v; std::memcpy(&v, p, sizeof(v)); return v; };
+	auto read32 = [](const char* p) { uint32_t v; std::memcpy(&v, p, sizeof(v)); return v; };
+	auto round = [](uint64_t acc, uint64_t input) {
+		return std::rotl(acc + input * prime2, 31) * prime1;
+	};
+	auto merge = [&round](uint64_t acc, uint64_t val) {
+		return (acc ^ round(0, val)) * prime1 + prime4;
+	};
 
-		it++;
+	const char* p = data;
+	const char* end = data + size;
+	uint64_t hash = 0;
+
+	/** Stripes */
+	if (size >= 32) {
+		uint64_t v1 = prime1 + prime2, v2 = prime2, v3 = 0, v4 = 0 - prime1;
+		for (; p + 32 <= end; p += 32) {
+			v1 = round(v1, read64(p));
+			v2 = round(v2, read64(p + 8));
+			v3 = round(v3, read64(p + 16));
+			v4 = round(v4, read64(p + 24));
+		}
+		hash = std::rotl(v1, 1) + std::rotl(v2, 7) + std::rotl(v3, 12) + std::rotl(v4, 18);
+		hash = merge(hash, v1);
+		hash = merge(hash, v2);
+		hash = merge(hash, v3);
+		hash = merge(hash, v4);
+	}
+	else {
+		hash = prime5;
+	}
+	hash += size;
+
+	/** Tail */
+	for (; p + 8 <= end; p += 8) {
+		hash = std::rotl(hash ^ round(0, read64(p)), 27) * prime1 + prime4;
+	}
+	if (p + 4 <= end) {
+		hash = std::rotl(hash ^ (read32(p) * prime1), 23) * prime2 + prime3;
+		p += 4;
 	}
+	for (; p < end; p++) {
+		hash = std::rotl(hash ^ (static_cast<uint8_t>(*p) * prime5), 11) * prime1;
+	}
+
+	/** Avalanche */
+	hash ^= hash >> 33;
+	hash *= prime2;
+	hash ^= hash >> 29;
+	hash *= prime3;
+	hash ^= hash >> 32;
+	return hash;
 }
@@ -1,27 +1,88 @@
 ﻿#pragma once
 
+#include "ModuleConfig.h"
+
 #include <ctime>
 #include <string>
 #include <map>
+#include <list>
+#include <vector>
 #include <memory>
 #include <tuple>
 #include <mutex>
+#include <shared_mutex>
+#include <atomic>
+#include <cstdint>
+#include <functional>
 
 class FileTemp final {
 public:
-	FileTemp(time_t survivalTime = 60);
+	FileTemp(time_t survivalTime = 60,
+		const ModuleConfig::TempConfig& tempConf = ModuleConfig::TempConfig{});
 
 	using MemoryBlock = std::tuple<std::shared_ptr<char>, size_t>;
-	MemoryBlock get(const std::string& path);
+	MemoryBlock get(const std::string& partition, const std::string& path);
+	using Loader = std::function<MemoryBlock(void)>;
+	MemoryBlock get(const std::string& partition, const std::string& key,
+		const Loader& loader, bool refresh = true);
 	void checkTempTime();
 
+	struct PartitionStats final {
+		size_t usage = 0;
+		size_t entries = 0;
+		size_t quota = 0;
+		size_t reserved = 0;
+		uint64_t hits = 0;
+		uint64_t misses = 0;
+	};
+	const std::map<std::string, PartitionStats> getAllStats();
+
 private:
 	const time_t survivalTime;
-	
-	using DataHolder = std::tuple<time_t, MemoryBlock>;
-	std::map<std::string, DataHolder> tempList;
-	std::mutex listLock;
+	const ModuleConfig::TempConfig tempConf;
+
+	struct Counter final {
+		std::atomic<uint64_t> hits = 0;
+		std::atomic<uint64_t> misses = 0;
+	};
+	std::map<std::string, std::shared_ptr<Counter>> counterList;
+	std::shared_ptr<Counter> otherCounter = std::make_shared<Counter>();
+	std::shared_mutex counterLock;
+
+	using LRUList = std::list<std::string>;
+	using DataHolder = std::tuple<time_t, MemoryBlock, LRUList::iterator, uint64_t>;
+	struct Partition final {
+		ModuleConfig::PartitionConfig conf;
+		std::map<std::string, DataHolder> tempList;
+		LRUList lruList;
+		size_t usage = 0;
+		std::shared_ptr<Counter> counter;
+		bool removed = false;
+		std::mutex listLock;
+	};
+	std::map<std::string, std::shared_ptr<Partition>> partitionList;
+	std::shared_mutex partitionLock;
+
+	using BlockHolder = std::tuple<MemoryBlock, size_t>;
+	std::multimap<uint64_t, BlockHolder> blockList;
+	std::mutex blockLock;
+
+	std::atomic<size_t> totalUsage = 0;
+	std::atomic<time_t> lastCheckTime = 0;
+
+	std::shared_ptr<Counter> getCounter(const std::string& partition);
+	std::shared_ptr<Partition> findPartition(const std::string& partition);
+	std::shared_ptr<Partition> getPartition(const std::string& partition);
+	const ModuleConfig::PartitionConfig& getPartitionConf(const std::string& partition) const;
+	bool reclaim(size_t size, const Partition* current);
+	void removeTemp(Partition& partition,
+		std::map<std::string, DataHolder>::iterator it);
+
+	MemoryBlock acquireBlock(const MemoryBlock& data, uint64_t hash, bool& created);
+	void releaseBlock(const MemoryBlock& data, uint64_t hash);
+	size_t getBlockRefCount(const MemoryBlock& data, uint64_t hash);
 
 	static MemoryBlock loadFile(const std::string& path);
+	static uint64_t hashContent(const char* data, size_t size);
 	void checkTempTimeInternal(time_t survivalTime);
 };
@@ -68,6 +68,117 @@ ModuleConfig::ModuleConfig(const std::string& path) {
 				}
 			}
 		}
+
+		/** Get Auto Index Config */
+		if (object.KeyExist("autoindex")) {
+			auto& autoIndexObj = object["autoindex"];
+			if (!autoIndexObj.IsEmpty()) {
+				this->autoIndex = true;
+
+				/** Get Format */
+				if (autoIndexObj.KeyExist("format")) {
+					autoIndexObj.Get("format", this->autoIndexConf.format);
+				}
+				if (this->autoIndexConf.format != "html" && this->autoIndexConf.format != "json") {
+					this->errorList.push_back("Autoindex format \"" + this->autoIndexConf.format
+						+ "\" unsupported, using \"html\"");
+					this->autoIndexConf.format = "html";
+				}
+
+				/** Get Page Size */
+				if (autoIndexObj.KeyExist("pageSize")) {
+					autoIndexObj.Get("pageSize", this->autoIndexConf.pageSize);
+				}
+
+				/** Get Show Hidden */
+				if (autoIndexObj.KeyExist("showHidden")) {
+					autoIndexObj.Get("showHidden", this->autoIndexConf.showHidden);
+				}
+			}
+		}
+
+		/** Get Cache Rules */
+		if (object.KeyExist("cacheRules")) {
+			auto& rulesObj = object["cacheRules"];
+			for (int i = 0; i < rulesObj.GetArraySize(); i++) {
+				auto& ruleObj = rulesObj[i];
+				CacheRuleConfig rule;
+
+				/** Get Match, Missing Match Reported By Cache Policy */
+				if (ruleObj.KeyExist("match")) {
+					ruleObj.Get("match", rule.match);
+				}
+
+				/** Get Cache Control */
+				if (ruleObj.KeyExist("cacheControl")) {
+					ruleObj.Get("cacheControl", rule.cacheControl);
+				}
+
+				/** Get Max Age, Seconds Or Duration String */
+				if (ruleObj.KeyExist("maxAge")) {
+					int64 maxAge = 0;
+					if (ruleObj.Get("maxAge", maxAge)) {
+						rule.maxAge = std::to_string(maxAge);
+					}
+					else {
+						ruleObj.Get("maxAge", rule.maxAge);
+					}
+				}
+
+				/** Get Flags */
+				if (ruleObj.KeyExist("immutable")) {
+					ruleObj.Get("immutable", rule.immutable);
+				}
+				if (ruleObj.KeyExist("noCache")) {
+					ruleObj.Get("noCache", rule.noCache);
+				}
+				if (ruleObj.KeyExist("noStore")) {
+					ruleObj.Get("noStore", rule.noStore);
+				}
+
+				this->cacheRules.push_back(rule);
+			}
+		}
+
+		/** Get Temp Config */
+		if (object.KeyExist("temp")) {
+			auto& tempObj = object["temp"];
+			if (!tempObj.IsEmpty()) {
+				/** Get Capacity */
+				if (tempObj.KeyExist("capacity")) {
+					uint64 capacity = 0;
+					tempObj.Get("capacity", capacity);
+					this->tempConf.capacity = capacity;
+				}
+
+				/** Get Stats Interval */
+				if (tempObj.KeyExist("statsInterval")) {
+					tempObj.Get("statsInterval", this->tempConf.statsInterval);
+				}
+
+				/** Get Stats Limit */
+				if (tempObj.KeyExist("statsLimit")) {
+					uint64 statsLimit = 0;
+					tempObj.Get("statsLimit", statsLimit);
+					this->tempConf.statsLimit = statsLimit;
+				}
+
+				/** Get Default Partition */
+				ModuleConfig::readPartitionConfig(tempObj, this->tempConf.defaultPartition);
+
+				/** Get Partitions */
+				if (tempObj.KeyExist("partitions")) {
+					auto& partitionsObj = tempObj["partitions"];
+					std::string key;
+					partitionsObj.ResetTraversing();
+					while (partitionsObj.GetKey(key)) {
+						auto conf = this->tempConf.defaultPartition;
+						ModuleConfig::readPartitionConfig(partitionsObj[key], conf);
+						this->tempConf.partitions[key] = conf;
+					}
+				}
+			}
+		}
 	}
 }
 
@@ -99,6 +210,42 @@ const ModuleConfig::FPMConfig& ModuleConfig::getFPMConf() const {
 	return this->fpmConf;
 }
 
+const ModuleConfig::TempConfig& ModuleConfig::getTempConf() const {
+	return this->tempConf;
+}
+
+bool ModuleConfig::getAutoIndexOn() const {
+	return this->autoIndex;
+}
+
+const ModuleConfig::AutoIndexConfig& ModuleConfig::getAutoIndexConf() const {
+	return this->autoIndexConf;
+}
+
+const std::vector<ModuleConfig::CacheRuleConfig>& ModuleConfig::getCacheRules() const {
+	return this->cacheRules;
+}
+
+const std::vector<std::string>& ModuleConfig::getErrors() const {
+	return this->errorList;
+}
+
+void ModuleConfig::readPartitionConfig(neb::CJsonObject& object, PartitionConfig& conf) {
+	/** Get Quota */
+	if (object.KeyExist("quota")) {
+		uint64 quota = 0;
+		object.Get("quota", quota);
+		conf.quota = quota;
+	}
+
+	/** Get Reserved */
+	if (object.KeyExist("reserved")) {
+		uint64 reserved = 0;
+		object.Get("reserved", reserved);
+		conf.reserved = reserved;
+	}
+}
+
 const std::string ModuleConfig::readFile(const std::string& path) {
 	std::stringstream result;
 
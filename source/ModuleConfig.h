@@ -3,6 +3,12 @@
 #include <string>
 #include <ctime>
 #include <cstdint>
+#include <map>
+#include <vector>
+
+namespace neb {
+	class CJsonObject;
+}
 
 class ModuleConfig final {
 public:
@@ -25,6 +31,39 @@ public:
 	bool getFPMOn() const;
 	const FPMConfig& getFPMConf() const;
 
+	struct PartitionConfig final {
+		size_t quota = 0;
+		size_t reserved = 0;
+	};
+	struct TempConfig final {
+		size_t capacity = 0;
+		time_t statsInterval = 60;
+		size_t statsLimit = 1024;
+		PartitionConfig defaultPartition;
+		std::map<std::string, PartitionConfig> partitions;
+	};
+	const TempConfig& getTempConf() const;
+
+	struct AutoIndexConfig final {
+		std::string format = "html";
+		int pageSize = 1000;
+		bool showHidden = false;
+	};
+	bool getAutoIndexOn() const;
+	const AutoIndexConfig& getAutoIndexConf() const;
+
+	struct CacheRuleConfig final {
+		std::string match;
+		std::string cacheControl;
+		std::string maxAge;
+		bool immutable = false;
+		bool noCache = false;
+		bool noStore = false;
+	};
+	const std::vector<CacheRuleConfig>& getCacheRules() const;
+
+	const std::vector<std::string>& getErrors() const;
+
 private:
 	time_t survivalTime = 60;
 	std::string root = "./$hostname$";
@@ -35,6 +74,16 @@ private:
 	bool fpm = false;
 	FPMConfig fpmConf;
 
+	TempConfig tempConf;
+
+	bool autoIndex = false;
+	AutoIndexConfig autoIndexConf;
+
+	std::vector<CacheRuleConfig> cacheRules;
+
+	std::vector<std::string> errorList;
+
+	static void readPartitionConfig(neb::CJsonObject& object, PartitionConfig& conf);
 	static const std::string readFile(const std::string& path);
 	static const std::string removeBOM(const std::string& src);
 };